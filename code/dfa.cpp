@@ -0,0 +1,801 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#include "dfa.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <thread>
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+namespace {
+
+constexpr unsigned unbounded = unsigned(-1);
+constexpr unsigned max_repeat = 1000;
+constexpr size_t max_nesting = 1000;
+constexpr size_t max_insts = size_t(1) << 20;
+
+//------------------------------------------------------------------------------
+struct node
+{
+    enum class kind : unsigned char
+    {
+        set,
+        cat,
+        alt,
+        repeat,
+        begin,
+        end,
+        empty
+    };
+    
+    explicit node(const kind k_) noexcept
+    : k(k_)
+    {}
+    
+    kind k;
+    uint32_t set = 0;
+    unsigned min = 0;
+    unsigned max = 0;
+    std::vector<node> kids;
+};
+
+//------------------------------------------------------------------------------
+/** Dangling exits of a partially compiled NFA. Each out is an instruction
+ * index shifted left by one, the lowest bit selects the x or y branch.
+ */
+struct frag
+{
+    uint32_t start;
+    std::vector<uint32_t> outs;
+};
+
+}
+
+//------------------------------------------------------------------------------
+class dfa_compiler
+{
+public:
+    dfa_compiler(dfa &d, const fnd::const_cstring s)
+    : d_(d), i_(s.begin()), e_(s.end())
+    {}
+    
+    void run()
+    {
+        const uint32_t entry = push(dfa::inst::code::jump);
+        
+        const node n = alternation(0);
+        if(i_ != e_)
+            error("Unmatched ')'.");
+        
+        frag f = emit(n);
+        d_.prog_[entry].x = f.start;
+        patch(f, push(dfa::inst::code::match));
+    }
+    
+private:
+    using code = dfa::inst::code;
+    using set_type = std::bitset<256>;
+    
+    [[noreturn]] static void error(const char *msg)
+    {
+        n_throw(dfa_error) << fnd::ei_msg_c(msg);
+    }
+    
+    //--------------------------------------------------------------------------
+    node alternation(const size_t depth)
+    {
+        node a = sequence(depth);
+        if(i_ == e_ || *i_ != '|')
+            return a;
+        
+        node n(node::kind::alt);
+        n.kids.push_back(fnd::move(a));
+        while(i_ != e_ && *i_ == '|')
+        {
+            ++i_;
+            n.kids.push_back(sequence(depth));
+        }
+        return n;
+    }
+    //--------------------------------------------------------------------------
+    node sequence(const size_t depth)
+    {
+        node n(node::kind::cat);
+        while(i_ != e_ && *i_ != '|' && *i_ != ')')
+            n.kids.push_back(repetition(depth));
+        
+        if(n.kids.empty())
+            return node(node::kind::empty);
+        if(n.kids.size() == 1)
+            return fnd::move(n.kids.front());
+        return n;
+    }
+    //--------------------------------------------------------------------------
+    node repetition(const size_t depth)
+    {
+        node a = atom(depth);
+        
+        while(i_ != e_)
+        {
+            unsigned min = 0;
+            unsigned max = 0;
+            
+            switch(*i_)
+            {
+            case '*':
+                max = unbounded;
+                ++i_;
+                break;
+            case '+':
+                min = 1;
+                max = unbounded;
+                ++i_;
+                break;
+            case '?':
+                max = 1;
+                ++i_;
+                break;
+            case '{':
+                ++i_;
+                bounds(min, max);
+                break;
+            default:
+                return a;
+            }
+            
+            // Laziness does not change what matches.
+            if(i_ != e_ && *i_ == '?')
+                ++i_;
+            
+            if(a.k == node::kind::begin || a.k == node::kind::end)
+                error("Nothing to repeat.");
+            
+            node r(node::kind::repeat);
+            r.min = min;
+            r.max = max;
+            r.kids.push_back(fnd::move(a));
+            a = fnd::move(r);
+        }
+        
+        return a;
+    }
+    //--------------------------------------------------------------------------
+    void bounds(unsigned &min, unsigned &max)
+    {
+        min = number();
+        max = min;
+        if(i_ != e_ && *i_ == ',')
+        {
+            ++i_;
+            max = (i_ != e_ && *i_ == '}') ? unbounded : number();
+        }
+        if(i_ == e_ || *i_ != '}')
+            error("Invalid repetition.");
+        ++i_;
+        
+        if(min > max)
+            error("Invalid repetition.");
+    }
+    //--------------------------------------------------------------------------
+    unsigned number()
+    {
+        if(i_ == e_ || !std::isdigit(static_cast<unsigned char>(*i_)))
+            error("Invalid repetition.");
+        
+        unsigned n = 0;
+        for( ; i_ != e_ && std::isdigit(static_cast<unsigned char>(*i_));
+            ++i_)
+        {
+            n = n * 10 + unsigned(*i_ - '0');
+            if(n > max_repeat)
+                error("Repetition count too large.");
+        }
+        return n;
+    }
+    //--------------------------------------------------------------------------
+    node atom(const size_t depth)
+    {
+        if(depth > max_nesting)
+            error("Nesting too deep.");
+        
+        const char c = *i_++;
+        switch(c)
+        {
+        case '(':
+        {
+            if(i_ != e_ && *i_ == '?')
+            {
+                if(i_ + 1 == e_ || i_[1] != ':')
+                    error("Lookarounds are not supported.");
+                i_ += 2;
+            }
+            node n = alternation(depth + 1);
+            if(i_ == e_ || *i_ != ')')
+                error("Missing ')'.");
+            ++i_;
+            return n;
+        }
+        case '[':
+            return make_set(bracket());
+        case '.':
+        {
+            set_type s;
+            s.set();
+            s.reset('\n');
+            s.reset('\r');
+            return make_set(s);
+        }
+        case '^':
+            return node(node::kind::begin);
+        case '$':
+            return node(node::kind::end);
+        case '\\':
+            return make_set(escape(false));
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            error("Nothing to repeat.");
+        default:
+        {
+            set_type s;
+            s.set(static_cast<unsigned char>(c));
+            return make_set(s);
+        }
+        }
+    }
+    //--------------------------------------------------------------------------
+    set_type escape(const bool in_class)
+    {
+        if(i_ == e_)
+            error("Trailing '\\'.");
+        
+        const char c = *i_++;
+        set_type s;
+        
+        const auto fill = [&s] (int (*pred)(int)) {
+            for(unsigned k = 0; k < 256; ++k)
+                if(pred(int(k)))
+                    s.set(k);
+        };
+        
+        switch(c)
+        {
+        case 'd':
+        case 'D':
+            fill([] (int k) { return int(k >= '0' && k <= '9'); });
+            break;
+        case 'w':
+        case 'W':
+            fill([] (int k) {
+                return int((k >= '0' && k <= '9') || (k >= 'a' && k <= 'z')
+                    || (k >= 'A' && k <= 'Z') || k == '_');
+            });
+            break;
+        case 's':
+        case 'S':
+            for(const char *k = " \t\n\v\f\r"; *k; ++k)
+                s.set(static_cast<unsigned char>(*k));
+            break;
+        case 't':
+            s.set('\t');
+            break;
+        case 'n':
+            s.set('\n');
+            break;
+        case 'r':
+            s.set('\r');
+            break;
+        case 'f':
+            s.set('\f');
+            break;
+        case 'v':
+            s.set('\v');
+            break;
+        case '0':
+            if(i_ != e_ && std::isdigit(static_cast<unsigned char>(*i_)))
+                error("Back-references are not supported.");
+            s.set(0);
+            break;
+        case 'x':
+        {
+            unsigned v = 0;
+            for(int k = 0; k < 2; ++k, ++i_)
+            {
+                if(i_ == e_ || !std::isxdigit(static_cast<unsigned char>(*i_)))
+                    error("Invalid hexadecimal escape.");
+                const char h = *i_;
+                v = v * 16 + unsigned(std::isdigit(static_cast<unsigned char>(h))
+                    ? h - '0'
+                    : (h | 0x20) - 'a' + 10);
+            }
+            s.set(v);
+            break;
+        }
+        case 'b':
+            if(!in_class)
+                error("Word boundaries are not supported.");
+            s.set('\b');
+            break;
+        case 'B':
+            error("Word boundaries are not supported.");
+        default:
+            if(c >= '1' && c <= '9')
+                error("Back-references are not supported.");
+            if(std::isalnum(static_cast<unsigned char>(c)))
+                error("Unknown escape sequence.");
+            s.set(static_cast<unsigned char>(c));
+            break;
+        }
+        
+        if(c == 'D' || c == 'W' || c == 'S')
+            s.flip();
+        return s;
+    }
+    //--------------------------------------------------------------------------
+    set_type bracket()
+    {
+        set_type s;
+        const bool negate = i_ != e_ && *i_ == '^';
+        if(negate)
+            ++i_;
+        
+        for(;;)
+        {
+            if(i_ == e_)
+                error("Missing ']'.");
+            if(*i_ == ']')
+            {
+                ++i_;
+                break;
+            }
+            
+            if(*i_ == '[' && i_ + 1 != e_ && i_[1] == ':')
+            {
+                s |= char_class();
+                continue;
+            }
+            
+            unsigned lo = 0;
+            if(!single(lo, s))
+                continue;
+            
+            if(i_ + 1 < e_ && *i_ == '-' && i_[1] != ']')
+            {
+                ++i_;
+                unsigned hi = 0;
+                if(!single(hi, s))
+                    error("Invalid range.");
+                if(hi < lo)
+                    error("Invalid range.");
+                for(unsigned k = lo; k <= hi; ++k)
+                    s.set(k);
+            }
+            else
+            {
+                s.set(lo);
+            }
+        }
+        
+        if(negate)
+            s.flip();
+        return s;
+    }
+    //--------------------------------------------------------------------------
+    /** Reads one character of a bracket expression. Escaped classes like
+     * \d are merged into s right away, in which case false is returned.
+     */
+    bool single(unsigned &c, set_type &s)
+    {
+        if(*i_ != '\\')
+        {
+            c = static_cast<unsigned char>(*i_++);
+            return true;
+        }
+        
+        ++i_;
+        const set_type x = escape(true);
+        if(x.count() != 1)
+        {
+            s |= x;
+            return false;
+        }
+        for(c = 0; !x.test(c); ++c) {}
+        return true;
+    }
+    //--------------------------------------------------------------------------
+    set_type char_class()
+    {
+        static const struct
+        {
+            const char *name;
+            int (*pred)(int);
+        } classes[] = {
+            {"alnum", ::isalnum}, {"alpha", ::isalpha}, {"blank", ::isblank},
+            {"cntrl", ::iscntrl}, {"digit", ::isdigit}, {"graph", ::isgraph},
+            {"lower", ::islower}, {"print", ::isprint}, {"punct", ::ispunct},
+            {"space", ::isspace}, {"upper", ::isupper},
+            {"xdigit", ::isxdigit}
+        };
+        
+        const char *b = i_ + 2;
+        const char *e = b;
+        while(e + 1 < e_ && !(e[0] == ':' && e[1] == ']'))
+            ++e;
+        if(e + 1 >= e_)
+            error("Missing ':]'.");
+        i_ = e + 2;
+        
+        for(const auto &x : classes)
+        {
+            if(std::strlen(x.name) != size_t(e - b)
+                || std::strncmp(x.name, b, size_t(e - b)) != 0)
+                continue;
+            
+            set_type s;
+            for(unsigned k = 0; k < 128; ++k)
+                if(x.pred(int(k)))
+                    s.set(k);
+            return s;
+        }
+        
+        error("Unknown character class.");
+    }
+    //--------------------------------------------------------------------------
+    node make_set(const set_type &s)
+    {
+        node n(node::kind::set);
+        n.set = uint32_t(d_.sets_.size());
+        d_.sets_.push_back(s);
+        return n;
+    }
+    
+    //--------------------------------------------------------------------------
+    uint32_t push(const code c, const uint32_t x = 0, const uint32_t y = 0)
+    {
+        if(d_.prog_.size() >= max_insts)
+            error("Regular expression too large.");
+        d_.prog_.push_back(dfa::inst{c, x, y});
+        return uint32_t(d_.prog_.size() - 1);
+    }
+    //--------------------------------------------------------------------------
+    void patch(const frag &f, const uint32_t target)
+    {
+        for(const uint32_t o : f.outs)
+        {
+            dfa::inst &x = d_.prog_[o >> 1];
+            if(o & 1u)
+                x.y = target;
+            else
+                x.x = target;
+        }
+    }
+    //--------------------------------------------------------------------------
+    void append(frag &acc, frag f)
+    {
+        if(acc.start == uint32_t(-1))
+        {
+            acc = fnd::move(f);
+            return;
+        }
+        patch(acc, f.start);
+        acc.outs = fnd::move(f.outs);
+    }
+    //--------------------------------------------------------------------------
+    frag single_out(const uint32_t i, const uint32_t branch = 0)
+    {
+        return frag{i, {(i << 1) | branch}};
+    }
+    //--------------------------------------------------------------------------
+    frag emit(const node &n)
+    {
+        switch(n.k)
+        {
+        case node::kind::set:
+            return single_out(push(code::set, 0, n.set));
+        case node::kind::begin:
+            return single_out(push(code::begin));
+        case node::kind::end:
+            return single_out(push(code::end));
+        case node::kind::empty:
+            return single_out(push(code::jump));
+        case node::kind::cat:
+        {
+            frag f{uint32_t(-1), {}};
+            for(const node &k : n.kids)
+                append(f, emit(k));
+            return f;
+        }
+        case node::kind::alt:
+        {
+            frag f = emit(n.kids.back());
+            for(size_t k = n.kids.size() - 1; k-- > 0; )
+            {
+                frag g = emit(n.kids[k]);
+                const uint32_t s = push(code::split, g.start, f.start);
+                g.outs.insert(g.outs.end(), f.outs.begin(), f.outs.end());
+                f = frag{s, fnd::move(g.outs)};
+            }
+            return f;
+        }
+        case node::kind::repeat:
+            return repeat(n);
+        }
+        error("Invalid regular expression.");
+    }
+    //--------------------------------------------------------------------------
+    frag repeat(const node &n)
+    {
+        const node &k = n.kids.front();
+        frag f{uint32_t(-1), {}};
+        
+        if(n.max == 0)
+            return single_out(push(code::jump));
+        
+        const unsigned copies = n.max == unbounded && n.min > 0
+            ? n.min - 1
+            : n.min;
+        for(unsigned i = 0; i < copies; ++i)
+            append(f, emit(k));
+        
+        if(n.max == unbounded)
+        {
+            // k* or, with a minimum, k+
+            frag g = emit(k);
+            const uint32_t s = push(code::split, g.start, 0);
+            patch(g, s);
+            append(f, frag{n.min > 0 ? g.start : s, {(s << 1) | 1u}});
+            return f;
+        }
+        
+        for(unsigned i = n.min; i < n.max; ++i)
+        {
+            frag g = emit(k);
+            const uint32_t s = push(code::split, g.start, 0);
+            g.outs.push_back((s << 1) | 1u);
+            append(f, frag{s, fnd::move(g.outs)});
+        }
+        return f;
+    }
+    
+    dfa &d_;
+    const char *i_;
+    const char *const e_;
+};
+
+//------------------------------------------------------------------------------
+dfa::dfa(const fnd::const_cstring pattern, const bool search,
+    const size_t max_memory)
+: search_(search), max_memory_(max_memory)
+{
+    dfa_compiler(*this, pattern).run();
+    
+    const size_t n = std::max(std::thread::hardware_concurrency(), 1u);
+    pool_.reserve(n);
+    for(size_t i = 0; i < n; ++i)
+        pool_.emplace_back(new cache());
+}
+//------------------------------------------------------------------------------
+dfa::~dfa() = default;
+//------------------------------------------------------------------------------
+bool dfa::operator () (const char *s, const size_t n) const
+{
+    cache &c = acquire();
+    std::lock_guard<std::mutex> lck(c.mtx, std::adopt_lock);
+    
+    if(c.mark.size() != prog_.size())
+        c.mark.assign(prog_.size(), 0);
+    
+    int32_t cur = start(c);
+    for(size_t i = 0; i < n; ++i)
+    {
+        const state &st = *c.states[size_t(cur)];
+        if(search_ && st.match)
+            return true;
+        if(st.insts.empty())
+            return false;
+        
+        const unsigned char b = static_cast<unsigned char>(s[i]);
+        const int32_t next = st.next[b];
+        cur = next >= 0 ? next : step(c, cur, b);
+    }
+    
+    return c.states[size_t(cur)]->match_at_end;
+}
+//------------------------------------------------------------------------------
+dfa::cache &dfa::acquire() const
+{
+    const size_t n = pool_.size();
+    const size_t first
+        = std::hash<std::thread::id>()(std::this_thread::get_id()) % n;
+    for(size_t k = 0; k < n; ++k)
+    {
+        cache &c = *pool_[(first + k) % n];
+        if(c.mtx.try_lock())
+            return c;
+    }
+    
+    cache &c = *pool_[first];
+    c.mtx.lock();
+    return c;
+}
+//------------------------------------------------------------------------------
+int32_t dfa::start(cache &c) const
+{
+    if(c.start < 0)
+    {
+        c.insts.clear();
+        if(++c.generation == 0)
+        {
+            std::fill(c.mark.begin(), c.mark.end(), 0);
+            c.generation = 1;
+        }
+        closure(c, 0, true);
+        const int32_t i = add(c, true);
+        c.start = i;
+    }
+    return c.start;
+}
+//------------------------------------------------------------------------------
+int32_t dfa::step(cache &c, const int32_t from, const unsigned char b) const
+{
+    c.insts.clear();
+    if(++c.generation == 0)
+    {
+        std::fill(c.mark.begin(), c.mark.end(), 0);
+        c.generation = 1;
+    }
+    
+    for(const uint32_t i : c.states[size_t(from)]->insts)
+    {
+        const inst &x = prog_[i];
+        if(x.c == inst::code::set && sets_[x.y].test(b))
+            closure(c, x.x, false);
+    }
+    if(search_)
+        closure(c, 0, false);
+    
+    const size_t epoch = c.epoch;
+    const int32_t to = add(c, false);
+    if(epoch == c.epoch)
+        c.states[size_t(from)]->next[b] = to;
+    return to;
+}
+//------------------------------------------------------------------------------
+int32_t dfa::add(cache &c, const bool at_begin) const
+{
+    std::sort(c.insts.begin(), c.insts.end());
+    
+    std::string key(1, at_begin ? '\1' : '\0');
+    key.append(reinterpret_cast<const char *>(c.insts.data()),
+        c.insts.size() * sizeof(uint32_t));
+    
+    const auto i = c.index.find(key);
+    if(i != c.index.end())
+        return i->second;
+    
+    const size_t cost = sizeof(state) + 2 * key.size() + 64;
+    if(!c.states.empty() && c.memory + cost > max_memory_)
+    {
+        c.states.clear();
+        c.index.clear();
+        c.memory = 0;
+        c.start = -1;
+        ++c.epoch;
+    }
+    
+    std::unique_ptr<state> st(new state());
+    st->insts = c.insts;
+    st->match = std::any_of(c.insts.begin(), c.insts.end(),
+        [this] (const uint32_t k) {
+            return prog_[k].c == inst::code::match;
+        });
+    st->match_at_end = accepts_at_end(c, at_begin);
+    st->next.fill(-1);
+    
+    const int32_t index = int32_t(c.states.size());
+    c.states.push_back(fnd::move(st));
+    c.index.emplace(fnd::move(key), index);
+    c.memory += cost;
+    return index;
+}
+//------------------------------------------------------------------------------
+void dfa::closure(cache &c, const uint32_t i, const bool at_begin) const
+{
+    c.stack.push_back(i);
+    while(!c.stack.empty())
+    {
+        const uint32_t k = c.stack.back();
+        c.stack.pop_back();
+        if(c.mark[k] == c.generation)
+            continue;
+        c.mark[k] = c.generation;
+        
+        const inst &x = prog_[k];
+        switch(x.c)
+        {
+        case inst::code::set:
+        case inst::code::end:
+        case inst::code::match:
+            c.insts.push_back(k);
+            break;
+        case inst::code::split:
+            c.stack.push_back(x.y);
+            c.stack.push_back(x.x);
+            break;
+        case inst::code::jump:
+            c.stack.push_back(x.x);
+            break;
+        case inst::code::begin:
+            if(at_begin)
+                c.stack.push_back(x.x);
+            break;
+        }
+    }
+}
+//------------------------------------------------------------------------------
+bool dfa::accepts_at_end(cache &c, const bool at_begin) const
+{
+    if(++c.generation == 0)
+    {
+        std::fill(c.mark.begin(), c.mark.end(), 0);
+        c.generation = 1;
+    }
+    
+    c.stack.assign(c.insts.begin(), c.insts.end());
+    bool accept = false;
+    while(!c.stack.empty())
+    {
+        const uint32_t k = c.stack.back();
+        c.stack.pop_back();
+        if(c.mark[k] == c.generation)
+            continue;
+        c.mark[k] = c.generation;
+        
+        const inst &x = prog_[k];
+        switch(x.c)
+        {
+        case inst::code::match:
+            accept = true;
+            break;
+        case inst::code::end:
+        case inst::code::jump:
+            c.stack.push_back(x.x);
+            break;
+        case inst::code::split:
+            c.stack.push_back(x.y);
+            c.stack.push_back(x.x);
+            break;
+        case inst::code::begin:
+            if(at_begin)
+                c.stack.push_back(x.x);
+            break;
+        case inst::code::set:
+            break;
+        }
+    }
+    c.stack.clear();
+    return accept;
+}
+
+} // recurse
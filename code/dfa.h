@@ -0,0 +1,130 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#ifndef RECURSE_DFA_H
+#define RECURSE_DFA_H
+
+#include <nebula/foundation/cstring.h>
+#include <nebula/foundation/exception.h>
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace recurse {
+
+namespace fnd = nebula::foundation;
+
+//------------------------------------------------------------------------------
+struct dfa_error : public virtual fnd::runtime_error {};
+
+//------------------------------------------------------------------------------
+constexpr size_t default_dfa_memory = size_t(8) * 1024 * 1024;
+
+//------------------------------------------------------------------------------
+/** A regular expression engine without backtracking.
+ *
+ * The pattern is compiled into an NFA whose DFA states are built lazily
+ * while matching, so the time spent is linear in the length of the input.
+ * The states are cached up to max_memory bytes, after which the cache is
+ * flushed and rebuilt as needed.
+ *
+ * The syntax is the ECMAScript one without back-references, lookarounds and
+ * word boundaries. '.' matches any byte except line breaks. Lazy
+ * quantifiers are accepted but behave like greedy ones, since only whether
+ * the input matches is of interest.
+ *
+ * Matching is thread-safe. Every concurrent caller works on its own cache.
+ */
+class dfa
+{
+public:
+    dfa(fnd::const_cstring pattern, bool search,
+        size_t max_memory = default_dfa_memory);
+    ~dfa();
+    
+    dfa(const dfa &) = delete;
+    dfa &operator = (const dfa &) = delete;
+    
+    bool operator () (const char *s, size_t n) const;
+    
+private:
+    struct inst
+    {
+        enum class code : unsigned char
+        {
+            set,
+            split,
+            jump,
+            begin,
+            end,
+            match
+        };
+        
+        code c;
+        uint32_t x;
+        uint32_t y;
+    };
+    
+    struct state
+    {
+        std::vector<uint32_t> insts;
+        bool match;
+        bool match_at_end;
+        std::array<int32_t, 256> next;
+    };
+    
+    struct cache
+    {
+        std::mutex mtx;
+        std::vector<std::unique_ptr<state>> states;
+        std::unordered_map<std::string, int32_t> index;
+        size_t memory = 0;
+        size_t epoch = 0;
+        int32_t start = -1;
+        std::vector<uint32_t> mark;
+        uint32_t generation = 0;
+        std::vector<uint32_t> stack;
+        std::vector<uint32_t> insts;
+    };
+    
+    friend class dfa_compiler;
+    
+    cache &acquire() const;
+    int32_t start(cache &c) const;
+    int32_t step(cache &c, int32_t from, unsigned char b) const;
+    int32_t add(cache &c, bool at_begin) const;
+    void closure(cache &c, uint32_t i, bool at_begin) const;
+    bool accepts_at_end(cache &c, bool at_begin) const;
+    
+    std::vector<inst> prog_;
+    std::vector<std::bitset<256>> sets_;
+    const bool search_;
+    const size_t max_memory_;
+    std::vector<std::unique_ptr<cache>> pool_;
+};
+
+} // recurse
+
+#endif // RECURSE_DFA_H
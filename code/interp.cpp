@@ -0,0 +1,183 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#include "interp.h"
+
+#include <nebula/foundation/format.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace recurse {
+
+namespace fmt = fnd::fmt;
+namespace io = fnd::io;
+
+//------------------------------------------------------------------------------
+inline static void append_uint(std::string &out, uintmax_t x)
+{
+    char buf[24];
+    char *i = buf + sizeof(buf);
+    do {
+        *--i = char('0' + x % 10);
+        x /= 10;
+    } while(x != 0);
+    out.append(i, buf + sizeof(buf));
+}
+//------------------------------------------------------------------------------
+template <class T>
+inline static void append_fmt(std::string &out, const T &x)
+{
+    io::msink<fnd::string> ss;
+    fmt::fwrite(ss, x);
+    out += ss.container();
+}
+
+//------------------------------------------------------------------------------
+interp_template::interp_template(const fnd::const_cstring s)
+{
+    auto i = s.begin();
+    
+    const auto add_literal = [&] (const char *b, const char *e) {
+        if(b == e)
+            return;
+        if(!ops_.empty() && ops_.back().f == field::literal)
+            ops_.back().size += size_t(e - b);
+        else
+            ops_.push_back(op{field::literal, literals_.size(),
+                size_t(e - b)});
+        literals_.append(b, e);
+    };
+    
+    while(i != s.end())
+    {
+        const char *lit = i;
+        while(i != s.end() && *i != '%')
+            ++i;
+        add_literal(lit, i);
+        if(i == s.end())
+            break;
+        
+        if(++i == s.end())
+            n_throw(interp_error)
+            << fnd::ei_msg_c("Unterminated field.");
+        
+        if(*i == '%')
+        {
+            add_literal(i, i + 1);
+            ++i;
+            continue;
+        }
+        
+        size_t n = 0;
+        const char *digits = i;
+        for( ; i != s.end() && *i >= '0' && *i <= '9'; ++i)
+        {
+            n = n * 10 + size_t(*i - '0');
+            if(n > size_t(field::depth))
+                n_throw(interp_error)
+                << fnd::ei_msg_c("Unknown field.");
+        }
+        if(i == digits || i == s.end() || *i != '%')
+            n_throw(interp_error)
+            << fnd::ei_msg_c("Unterminated field.");
+        ++i;
+        
+        ops_.push_back(op{field(n), 0, 0});
+        fields_ |= 1u << unsigned(n);
+    }
+}
+//------------------------------------------------------------------------------
+bool interp_template::needs_status() const noexcept
+{
+    return uses(field::last_access)
+        || uses(field::last_modification)
+        || uses(field::last_status_change)
+        || uses(field::permissions);
+}
+//------------------------------------------------------------------------------
+void interp_template::format(const entry &e, std::string &out) const
+{
+    if(needs_status())
+    {
+        const fs::file_status stat
+            = fs::status(fs::path(fnd::const_cstring(e.path().c_str())));
+        format(e, &stat, out);
+    }
+    else
+    {
+        format(e, nullptr, out);
+    }
+}
+//------------------------------------------------------------------------------
+void interp_template::format(const entry &e, const fs::file_status *stat,
+    std::string &out) const
+{
+    // Without any other status field the size is cheaper to get from an
+    // fstatat() relative to the directory.
+    uintmax_t size = 0;
+    if(uses(field::size) && !stat)
+    {
+        struct ::stat st;
+        if(::fstatat(e.dir_fd, e.name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            n_throw(interp_error)
+            << fnd::ei_msg_c("Accessing a path failed.")
+            << fs::ei_path(fs::path(fnd::const_cstring(e.path().c_str())));
+        size = uintmax_t(st.st_size);
+    }
+    
+    for(const op &x : ops_)
+    {
+        switch(x.f)
+        {
+        case field::literal:
+            out.append(literals_, x.begin, x.size);
+            break;
+        case field::path:
+            out += e.path();
+            break;
+        case field::type:
+            out += fs::to_cstr(e.type);
+            break;
+        case field::size:
+            if(stat)
+                append_fmt(out, fs::size(*stat));
+            else
+                append_uint(out, size);
+            break;
+        case field::last_access:
+            append_fmt(out, fs::last_access(*stat));
+            break;
+        case field::last_modification:
+            append_fmt(out, fs::last_modification(*stat));
+            break;
+        case field::last_status_change:
+            append_fmt(out, fs::last_status_change(*stat));
+            break;
+        case field::permissions:
+            append_fmt(out, fs::pretty_permissions(*stat));
+            break;
+        case field::depth:
+            append_uint(out, e.level);
+            break;
+        }
+    }
+}
+
+} // recurse
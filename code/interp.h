@@ -0,0 +1,94 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#ifndef RECURSE_INTERP_H
+#define RECURSE_INTERP_H
+
+#include <nebula/foundation/cstring.h>
+#include <nebula/foundation/exception.h>
+
+#include <string>
+#include <vector>
+
+#include "walker.h"
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+struct interp_error : public virtual fnd::runtime_error {};
+
+//------------------------------------------------------------------------------
+/** An interpolation string (see --interpolate) compiled into a sequence of
+ * literals and fields.
+ *
+ * Only the fields that occur in the string are computed for an entry. The
+ * file status is only queried if one of the fields %2% to %6% occurs.
+ */
+class interp_template
+{
+public:
+    interp_template() = default;
+    explicit interp_template(fnd::const_cstring s);
+    
+    bool empty() const noexcept
+    {
+        return ops_.empty();
+    }
+    
+    bool needs_status() const noexcept;
+    
+    void format(const entry &e, std::string &out) const;
+    
+private:
+    enum class field : unsigned char
+    {
+        path,
+        type,
+        size,
+        last_access,
+        last_modification,
+        last_status_change,
+        permissions,
+        depth,
+        literal
+    };
+    
+    struct op
+    {
+        field f;
+        size_t begin;
+        size_t size;
+    };
+    
+    void format(const entry &e, const fs::file_status *stat,
+        std::string &out) const;
+    
+    bool uses(const field f) const noexcept
+    {
+        return (fields_ & (1u << unsigned(f))) != 0u;
+    }
+    
+    std::vector<op> ops_;
+    std::string literals_;
+    unsigned fields_ = 0;
+};
+
+} // recurse
+
+#endif // RECURSE_INTERP_H
@@ -0,0 +1,81 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#include "literal.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#   include <emmintrin.h>
+#endif
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+const char *literal::find(const char *s, const size_t n) const noexcept
+{
+    const size_t m = needle_.size();
+    if(m == 0)
+        return s;
+    if(n < m)
+        return nullptr;
+    
+    const char *needle = needle_.data();
+    if(m == 1)
+        return static_cast<const char *>(std::memchr(s, needle[0], n));
+    
+    size_t i = 0;
+    
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    
+    for( ; i + m + 15 <= n; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(s + i));
+        const __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(s + i + m - 1));
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+        
+        while(mask != 0u)
+        {
+            const size_t k = i + size_t(__builtin_ctz(mask));
+            if(std::memcmp(s + k + 1, needle + 1, m - 2) == 0)
+                return s + k;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    
+    const char *const end = s + n - m + 1;
+    for(const char *p = s + i; p < end; ++p)
+    {
+        p = static_cast<const char *>(
+            std::memchr(p, needle[0], size_t(end - p)));
+        if(!p)
+            break;
+        if(std::memcmp(p + 1, needle + 1, m - 1) == 0)
+            return p;
+    }
+    return nullptr;
+}
+
+} // recurse
@@ -0,0 +1,76 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#ifndef RECURSE_LITERAL_H
+#define RECURSE_LITERAL_H
+
+#include <string>
+#include <utility>
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+/** Substring search for a fixed needle.
+ *
+ * With SSE2 sixteen candidate positions are tested at once by comparing
+ * the first and the last byte of the needle. Only candidates that pass
+ * both are compared in full.
+ */
+class literal
+{
+public:
+    literal() = default;
+    explicit literal(std::string needle)
+    : needle_(std::move(needle))
+    {}
+    
+    const std::string &str() const noexcept
+    {
+        return needle_;
+    }
+    size_t size() const noexcept
+    {
+        return needle_.size();
+    }
+    
+    const char *find(const char *s, size_t n) const noexcept;
+    
+    bool equals(const char *s, const size_t n) const noexcept
+    {
+        return n == needle_.size() && needle_.compare(0, n, s, n) == 0;
+    }
+    bool prefix_of(const char *s, const size_t n) const noexcept
+    {
+        return n >= needle_.size()
+            && needle_.compare(0, needle_.size(), s, needle_.size()) == 0;
+    }
+    bool suffix_of(const char *s, const size_t n) const noexcept
+    {
+        return n >= needle_.size()
+            && needle_.compare(0, needle_.size(),
+                s + (n - needle_.size()), needle_.size()) == 0;
+    }
+    
+private:
+    std::string needle_;
+};
+
+} // recurse
+
+#endif // RECURSE_LITERAL_H
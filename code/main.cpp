@@ -26,6 +26,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <nebula/foundation/opts.h>
 #include <nebula/foundation/qlog.h>
 
+#include <thread>
+
+#include <unistd.h>
+
+#include "interp.h"
+#include "matcher.h"
+#include "output.h"
+#include "walker.h"
+
 namespace fnd = nebula::foundation;
 namespace fs = fnd::filesystem;
 namespace fmt = fnd::fmt;
@@ -107,6 +116,11 @@ inline void print_help(const fnd::const_cstring argv0)
 "-v --verbose       Verbose error messages intended for debugging.", fmt::endl,
 
 "-d --depth         Maximum search depth. [infinite]", fmt::endl,
+"-j --jobs          Number of threads used to traverse directories. [1]", fmt::endl,
+"                   A value of 0 selects the number of available CPUs.", fmt::endl,
+"                   The order of outputs is unspecified if greater than 1.", fmt::endl,
+"--max-fds          Maximum number of directories kept open in order to open", fmt::endl,
+"                   their subdirectories relative to them. [256]", fmt::endl,
 "-t --type          The type of files to scan for. [f]", fmt::endl,
 "                   Multiple options are allowed.", fmt::endl,
 "                   For example \"sf\" indicates a search for regular and", fmt::endl,
@@ -122,12 +136,18 @@ inline void print_help(const fnd::const_cstring argv0)
 "-c --canonical     Make all paths absolute (canonical).", fmt::endl,
 "-n --newline       Append a newline (\\n) after each output. If not set, then", fmt::endl,
 "                   outputs are seperated by spaces.", fmt::endl,
+"--buffer-size      Size of the output buffer of each job in bytes. [262144]", fmt::endl,
+"--line-buffered    Write every output immediately. This is the default if", fmt::endl,
+"                   the standard output is a terminal.", fmt::endl,
 "-r --regex         A regular expression to filter paths. [.*]", fmt::endl,
 "-rt --regex-type   Set the regular expression type. [ecma]", fmt::endl,
 "                   Available options are: egrep, ecma, posix, eposix.", fmt::endl,
 "-rm --regex-match  Match the path exactly.", fmt::endl,
 "                   By default the regular expression engine 'searches' the path", fmt::endl,
 "                   and selects the path if only a fragment of it matches.", fmt::endl,
+"-g --glob          A shell pattern to filter paths. Supports *, ? and [...].", fmt::endl,
+"                   Without a '/' the pattern is matched against file names,", fmt::endl,
+"                   otherwise against whole paths. Combines with --regex.", fmt::endl,
 "-i --interpolate   Format the output using string interpolation.", fmt::endl,
 "                       %%  ... print %", fmt::endl,
 "                       %0% ... path", fmt::endl,
@@ -191,10 +211,15 @@ int main(int argc, char **argv)
         fnd::vector<fnd::const_cstring> opt_paths;
         unsigned opt_type_mask = regular_f;
         size_t opt_max_depth = math::maximum<size_t>();
+        size_t opt_jobs = 1;
+        size_t opt_max_fds = recurse::default_max_fds;
         bool opt_canonical = false;
         bool opt_newline = false;
+        size_t opt_buffer_size = recurse::default_buffer_size;
+        bool opt_line_buffered = ::isatty(STDOUT_FILENO) == 1;
         fnd::const_cstring opt_interpolate;
         fnd::const_cstring opt_rx;
+        fnd::const_cstring opt_glob;
         regex::regex_option_type opt_rx_type = regex::ecma;
         bool opt_rx_search = true;
         int quit = -1;
@@ -322,6 +347,52 @@ int main(int argc, char **argv)
                     return true;
                 },
                 "depth", "d"),
+            fnd::opts::argument(
+                [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
+                    if(val.empty())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Missing value. '-", id, "=?'.");
+                        return false;
+                    }
+                    auto r = fmt::to_integer<size_t>(
+                        val, 10, fnd::nothrow_tag());
+                    if(!r.valid())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Expected a positive number. ",
+                            "--", id, "=#ERROR");
+                        return false;
+                    }
+                    opt_jobs = r.get();
+                    if(opt_jobs == 0)
+                        opt_jobs = std::thread::hardware_concurrency();
+                    if(opt_jobs == 0)
+                        opt_jobs = 1;
+                    return true;
+                },
+                "jobs", "j"),
+            fnd::opts::argument(
+                [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
+                    if(val.empty())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Missing value. '-", id, "=?'.");
+                        return false;
+                    }
+                    auto r = fmt::to_integer<size_t>(
+                        val, 10, fnd::nothrow_tag());
+                    if(!r.valid())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Expected a positive number. ",
+                            "--", id, "=#ERROR");
+                        return false;
+                    }
+                    opt_max_fds = r.get();
+                    return true;
+                },
+                "max-fds"),
             fnd::opts::argument(
                 [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
                     if(!val.empty())
@@ -338,6 +409,35 @@ int main(int argc, char **argv)
                     return true;
                 },
                 "newline", "n"),
+            fnd::opts::argument(
+                [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
+                    if(val.empty())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Missing value. '-", id, "=?'.");
+                        return false;
+                    }
+                    auto r = fmt::to_integer<size_t>(
+                        val, 10, fnd::nothrow_tag());
+                    if(!r.valid())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Expected a positive number. ",
+                            "--", id, "=#ERROR");
+                        return false;
+                    }
+                    opt_buffer_size = r.get();
+                    return true;
+                },
+                "buffer-size"),
+            fnd::opts::argument(
+                [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
+                    if(!val.empty())
+                        gl->warning("Value ignored. '-", id, "' is a flag.");
+                    opt_line_buffered = true;
+                    return true;
+                },
+                "line-buffered"),
             fnd::opts::argument(
                 [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
                     if(val.empty())
@@ -370,6 +470,18 @@ int main(int argc, char **argv)
                         gl->error("Missing value. '-", id, "=?'.");
                         return false;
                     }
+                    opt_glob = val;
+                    return true;
+                },
+                "glob", "g"),
+            fnd::opts::argument(
+                [&] (fnd::const_cstring id, fnd::const_cstring val, size_t i) {
+                    if(val.empty())
+                    {
+                        quit = EXIT_FAILURE;
+                        gl->error("Missing value. '-", id, "=?'.");
+                        return false;
+                    }
                     
                     if(val == "grep")
                         opt_rx_type = regex::grep;
@@ -405,16 +517,12 @@ int main(int argc, char **argv)
         if(quit != -1)
             return quit;
         
-        regex::default_regex *rx = nullptr;
-        n_scope_exit(&) {
-            if(rx)
-                delete rx;
-        };
+        recurse::matcher rx;
         if(!opt_rx.empty() && opt_rx != ".*")
         {
             try {
-                rx = new regex::default_regex(
-                    opt_rx, regex::optimize | opt_rx_type);
+                rx = recurse::matcher::from_regex(
+                    opt_rx, opt_rx_type, opt_rx_search);
             } catch(const regex::regex_error &e) {
                 gl->error("Compiling a regular expression failed.");
                 gl->debug(fnd::diagnostic_information(e));
@@ -422,11 +530,26 @@ int main(int argc, char **argv)
             }
         }
         
-        auto f = [&](fs::path p, size_t level) -> bool
-        {   
-            const fs::file_status stat = fs::status(p);
- 
-            switch(fs::type(stat))
+        const recurse::matcher glob = opt_glob.empty()
+            ? recurse::matcher()
+            : recurse::matcher::from_glob(opt_glob);
+        
+        recurse::interp_template interp;
+        try {
+            interp = recurse::interp_template(opt_interpolate);
+        } catch(const recurse::interp_error &e) {
+            gl->error("Compiling the interpolation string failed.");
+            gl->debug(fnd::diagnostic_information(e));
+            return EXIT_FAILURE;
+        }
+        
+        recurse::walker w(opt_jobs, opt_max_depth, opt_max_fds);
+        recurse::writer out(STDOUT_FILENO, w.jobs(),
+            opt_buffer_size, opt_line_buffered);
+        
+        auto f = [&](const recurse::entry &e) -> bool
+        {
+            switch(e.type)
             {
             case fs::file_type::regular:
                 if((opt_type_mask & regular_f) == 0u)
@@ -460,47 +583,32 @@ int main(int argc, char **argv)
                 n_throw(logic_error);
             }
             
-            if(rx)
-            {
-                if(opt_rx_search) {
-                    if(!regex::search(p.str(), *rx))
-                        return true;
-                } else {
-                    if(!regex::match(p.str(), *rx))
-                        return true;
-                }
-            }
+            if(!glob(e) || !rx(e))
+                return true;
+            
+            std::string &buf = out.buffer(e.job);
             
-            if(opt_interpolate.empty())
+            if(interp.empty())
             {
-                fmt::fwrite(io::cout, p);
+                buf += e.path();
             }
             else
             {
+                const size_t mark = buf.size();
                 try {
-                    fmt::interp(
-                        io::cout,
-                        opt_interpolate,
-                        p,
-                        fs::to_cstr(fs::type(stat)),
-                        fs::size(stat),
-                        fs::last_access(stat),
-                        fs::last_modification(stat),
-                        fs::last_status_change(stat),
-                        fs::pretty_permissions(stat),
-                        level);
+                    interp.format(e, buf);
                 } catch(...) {
+                    buf.resize(mark);
                     n_throw(runtime_error)
                     << fnd::ei_msg_c("String interpolation failed.")
                     << fnd::ei_exc(fnd::current_exception())
-                    << fs::ei_path(p);
+                    << fs::ei_path(fs::path(
+                        fnd::const_cstring(e.path().c_str())));
                 }
             }
             
-            if(opt_newline)
-                io::put(io::cout, '\n');
-            else
-                io::put(io::cout, ' ');
+            buf.push_back(opt_newline ? '\n' : ' ');
+            out.commit(e.job);
             
             return true;
         };
@@ -513,8 +621,11 @@ int main(int argc, char **argv)
             const fs::path path = opt_canonical
                 ? fs::canonical(x)
                 : x;
-            fs::recursive_scan(path, opt_max_depth, f);
+            w.push(path.str());
         }
+        
+        w.run(f);
+        out.flush();
     }
     catch(const fnd::exception &e)
     {
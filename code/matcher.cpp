@@ -0,0 +1,403 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#include "matcher.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+namespace {
+
+struct regex_literal
+{
+    std::string lit;
+    bool begin = false;
+    bool end = false;
+    bool lead = false;
+    bool trail = false;
+};
+
+}
+
+//------------------------------------------------------------------------------
+/** Recognizes patterns of the form [^][.*]literal[.*][$], where the literal
+ * may contain escaped punctuation.
+ */
+inline static bool analyse_regex(const fnd::const_cstring rx,
+    const bool basic, regex_literal &r)
+{
+    const char *i = rx.begin();
+    const char *const e = rx.end();
+    
+    if(i != e && *i == '^')
+    {
+        r.begin = true;
+        ++i;
+    }
+    
+    // 0: leading '.*', 1: literal, 2: trailing '.*'
+    int phase = 0;
+    while(i != e)
+    {
+        const char c = *i;
+        
+        if(c == '.' && i + 1 != e && i[1] == '*')
+        {
+            if(i + 2 != e && std::strchr("*+?{", i[2]))
+                return false;
+            if(phase == 0)
+                r.lead = true;
+            else
+            {
+                phase = 2;
+                r.trail = true;
+            }
+            i += 2;
+            continue;
+        }
+        
+        if(c == '$' && i + 1 == e)
+        {
+            r.end = true;
+            break;
+        }
+        
+        char x = c;
+        if(c == '\\')
+        {
+            if(++i == e)
+                return false;
+            x = *i;
+            if(!std::ispunct(static_cast<unsigned char>(x)))
+                return false;
+            if(basic && std::strchr("(){}|+?<>`'", x))
+                return false;
+        }
+        else if(std::strchr(basic ? ".[]*^$\n" : ".[](){}*+?|^$\n", c))
+        {
+            return false;
+        }
+        
+        if(phase == 2)
+            return false;
+        phase = 1;
+        r.lit.push_back(x);
+        ++i;
+    }
+    
+    return true;
+}
+
+//------------------------------------------------------------------------------
+matcher matcher::from_regex(const fnd::const_cstring rx,
+    const regex::regex_option_type type, const bool search)
+{
+    matcher m;
+    m.rx_search_ = search;
+    
+    const bool basic = type == regex::grep || type == regex::basic_posix;
+    regex_literal r;
+    if(!analyse_regex(rx, basic, r))
+    {
+        m.kind_ = kind::regex;
+        m.rx_ = std::make_shared<regex::default_regex>(
+            rx, regex::optimize | type);
+        return m;
+    }
+    
+    // A match has to cover the whole path, as if anchored on both ends.
+    const bool begin = r.begin || !search;
+    const bool end = r.end || !search;
+    
+    m.line_ = (begin && r.lead) || (end && r.trail);
+    if(m.line_)
+        m.rx_ = std::make_shared<regex::default_regex>(
+            rx, regex::optimize | type);
+    
+    const bool prefix = begin && !r.lead;
+    const bool suffix = end && !r.trail;
+    
+    if(prefix && suffix)
+        m.kind_ = kind::equal;
+    else if(prefix)
+        m.kind_ = kind::prefix;
+    else if(suffix)
+        m.kind_ = kind::suffix;
+    else if(!r.lit.empty() || m.line_)
+        m.kind_ = kind::contains;
+    else
+        m.kind_ = kind::any;
+    
+    m.lit_ = literal(fnd::move(r.lit));
+    return m;
+}
+//------------------------------------------------------------------------------
+matcher matcher::from_glob(const fnd::const_cstring g)
+{
+    matcher m;
+    m.by_name_ = std::find(g.begin(), g.end(), '/') == g.end();
+    
+    const auto add_literal = [&m] (const char c) {
+        if(!m.glob_.empty() && m.glob_.back().c == glob_op::code::literal)
+            ++m.glob_.back().size;
+        else
+            m.glob_.push_back(glob_op{glob_op::code::literal,
+                m.glob_literals_.size(), 1});
+        m.glob_literals_.push_back(c);
+    };
+    
+    for(const char *i = g.begin(); i != g.end(); ++i)
+    {
+        switch(*i)
+        {
+        case '*':
+            if(m.glob_.empty() || m.glob_.back().c != glob_op::code::star)
+                m.glob_.push_back(glob_op{glob_op::code::star, 0, 0});
+            break;
+        case '?':
+            m.glob_.push_back(glob_op{glob_op::code::one, 0, 0});
+            break;
+        case '\\':
+            if(i + 1 != g.end())
+                ++i;
+            add_literal(*i);
+            break;
+        case '[':
+        {
+            const char *j = i + 1;
+            const bool negate = j != g.end() && (*j == '!' || *j == '^');
+            if(negate)
+                ++j;
+            
+            std::bitset<256> set;
+            bool first = true;
+            for( ; j != g.end() && (first || *j != ']'); ++j)
+            {
+                first = false;
+                if(*j == '\\' && j + 1 != g.end())
+                    ++j;
+                const unsigned char lo = static_cast<unsigned char>(*j);
+                if(j + 2 < g.end() && j[1] == '-' && j[2] != ']')
+                {
+                    j += 2;
+                    if(*j == '\\' && j + 1 != g.end())
+                        ++j;
+                    const unsigned char hi = static_cast<unsigned char>(*j);
+                    for(unsigned k = lo; k <= hi; ++k)
+                        set.set(k);
+                }
+                else
+                {
+                    set.set(lo);
+                }
+            }
+            
+            if(j == g.end())
+            {
+                // Unterminated, so not a set at all.
+                add_literal('[');
+                break;
+            }
+            
+            if(negate)
+                set.flip();
+            m.glob_.push_back(glob_op{glob_op::code::set,
+                m.glob_sets_.size(), 0});
+            m.glob_sets_.push_back(set);
+            i = j;
+            break;
+        }
+        default:
+            add_literal(*i);
+            break;
+        }
+    }
+    
+    // Shapes that boil down to a literal comparison.
+    using code = glob_op::code;
+    const auto &ops = m.glob_;
+    const auto is = [&ops] (const size_t k, const code c) {
+        return ops[k].c == c;
+    };
+    const auto lit = [&m] (const glob_op &x) {
+        return literal(m.glob_literals_.substr(x.begin, x.size));
+    };
+    
+    m.kind_ = kind::glob;
+    if(ops.empty())
+    {
+        m.kind_ = kind::equal;
+    }
+    else if(ops.size() == 1 && is(0, code::star))
+    {
+        m.kind_ = kind::any;
+    }
+    else if(ops.size() == 1 && is(0, code::literal))
+    {
+        m.kind_ = kind::equal;
+        m.lit_ = lit(ops[0]);
+    }
+    else if(ops.size() == 2 && is(0, code::star) && is(1, code::literal))
+    {
+        m.kind_ = kind::suffix;
+        m.lit_ = lit(ops[1]);
+    }
+    else if(ops.size() == 2 && is(0, code::literal) && is(1, code::star))
+    {
+        m.kind_ = kind::prefix;
+        m.lit_ = lit(ops[0]);
+    }
+    else if(ops.size() == 3 && is(0, code::star) && is(1, code::literal)
+        && is(2, code::star))
+    {
+        m.kind_ = kind::contains;
+        m.lit_ = lit(ops[1]);
+    }
+    
+    return m;
+}
+//------------------------------------------------------------------------------
+bool matcher::operator () (const entry &e) const
+{
+    if(kind_ == kind::any)
+        return true;
+    
+    if(by_name_)
+    {
+        const char *s = e.name;
+        if(const char *slash = std::strrchr(s, '/'))
+            s = slash + 1;
+        return (*this)(s, std::strlen(s));
+    }
+    
+    return match(e.path().data(), e.path().size(), &e.path());
+}
+//------------------------------------------------------------------------------
+bool matcher::operator () (const char *s, const size_t n) const
+{
+    return match(s, n, nullptr);
+}
+//------------------------------------------------------------------------------
+bool matcher::match(const char *s, const size_t n,
+    const std::string *str) const
+{
+    if(line_ && (std::memchr(s, '\n', n) || std::memchr(s, '\r', n)))
+        return regex_match(s, n, str);
+    
+    switch(kind_)
+    {
+    case kind::any:
+        return true;
+    case kind::equal:
+        return lit_.equals(s, n);
+    case kind::prefix:
+        return lit_.prefix_of(s, n);
+    case kind::suffix:
+        return lit_.suffix_of(s, n);
+    case kind::contains:
+        return lit_.find(s, n) != nullptr;
+    case kind::glob:
+        return glob_match(s, n);
+    case kind::regex:
+        return regex_match(s, n, str);
+    }
+    return false;
+}
+//------------------------------------------------------------------------------
+bool matcher::regex_match(const char *s, const size_t n,
+    const std::string *str) const
+{
+    if(!str)
+    {
+        const std::string tmp(s, n);
+        return regex_match(s, n, &tmp);
+    }
+    
+    return rx_search_
+        ? regex::search(*str, *rx_)
+        : regex::match(*str, *rx_);
+}
+//------------------------------------------------------------------------------
+bool matcher::glob_match(const char *s, const size_t n) const noexcept
+{
+    constexpr size_t npos = size_t(-1);
+    
+    size_t oi = 0;
+    size_t si = 0;
+    size_t star_oi = npos;
+    size_t star_si = 0;
+    
+    while(si < n || oi < glob_.size())
+    {
+        if(oi < glob_.size())
+        {
+            const glob_op &x = glob_[oi];
+            switch(x.c)
+            {
+            case glob_op::code::star:
+                star_oi = oi++;
+                star_si = si;
+                continue;
+            case glob_op::code::literal:
+                if(n - si >= x.size && std::memcmp(s + si,
+                    glob_literals_.data() + x.begin, x.size) == 0)
+                {
+                    si += x.size;
+                    ++oi;
+                    continue;
+                }
+                break;
+            case glob_op::code::one:
+                if(si < n)
+                {
+                    ++si;
+                    ++oi;
+                    continue;
+                }
+                break;
+            case glob_op::code::set:
+                if(si < n && glob_sets_[x.begin].test(
+                    static_cast<unsigned char>(s[si])))
+                {
+                    ++si;
+                    ++oi;
+                    continue;
+                }
+                break;
+            }
+        }
+        
+        // Let the last star swallow one more character and retry.
+        if(star_oi != npos && star_si < n)
+        {
+            oi = star_oi + 1;
+            si = ++star_si;
+            continue;
+        }
+        return false;
+    }
+    
+    return true;
+}
+
+} // recurse
@@ -0,0 +1,115 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#ifndef RECURSE_MATCHER_H
+#define RECURSE_MATCHER_H
+
+#include <nebula/foundation/cstring.h>
+#include <nebula/foundation/regex.h>
+
+#include <bitset>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "literal.h"
+#include "walker.h"
+
+namespace recurse {
+
+namespace regex = fnd::regex;
+
+//------------------------------------------------------------------------------
+/** A path filter.
+ *
+ * Regular expressions are analysed when the matcher is built. If a pattern
+ * turns out to be a plain literal, optionally anchored, it is matched with
+ * a substring search or a prefix, suffix or equality comparison. Only real
+ * regular expressions are run through regex::default_regex.
+ *
+ * Globs are compiled as well. A glob without a '/' is matched against the
+ * name of an entry, otherwise against its full path. '*' also matches '/'.
+ */
+class matcher
+{
+public:
+    matcher() = default;
+    
+    static matcher from_regex(fnd::const_cstring rx,
+        regex::regex_option_type type, bool search);
+    static matcher from_glob(fnd::const_cstring glob);
+    
+    bool any() const noexcept
+    {
+        return kind_ == kind::any;
+    }
+    
+    bool operator () (const entry &e) const;
+    bool operator () (const char *s, size_t n) const;
+    
+private:
+    enum class kind
+    {
+        any,
+        equal,
+        prefix,
+        suffix,
+        contains,
+        glob,
+        regex
+    };
+    
+    struct glob_op
+    {
+        enum class code : unsigned char
+        {
+            literal,
+            one,
+            star,
+            set
+        };
+        
+        code c;
+        size_t begin;
+        size_t size;
+    };
+    
+    bool match(const char *s, size_t n, const std::string *str) const;
+    bool regex_match(const char *s, size_t n, const std::string *str) const;
+    bool glob_match(const char *s, size_t n) const noexcept;
+    
+    kind kind_ = kind::any;
+    literal lit_;
+    bool by_name_ = false;
+    
+    /* Set if a '.*' next to an anchor was folded away. These only hold for
+     * paths without line breaks, others are left to the regex.
+     */
+    bool line_ = false;
+    std::shared_ptr<regex::default_regex> rx_;
+    bool rx_search_ = true;
+    
+    std::vector<glob_op> glob_;
+    std::string glob_literals_;
+    std::vector<std::bitset<256>> glob_sets_;
+};
+
+} // recurse
+
+#endif // RECURSE_MATCHER_H
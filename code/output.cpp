@@ -0,0 +1,135 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#include "output.h"
+
+#include <cerrno>
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef IOV_MAX
+#   define IOV_MAX 16
+#endif
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+writer::writer(const int fd, const size_t slots, const size_t buffer_size,
+    const bool line_buffered)
+: fd_(fd), buffer_size_(buffer_size), line_buffered_(line_buffered)
+{
+    const size_t n = slots == 0 ? 1 : slots;
+    slots_.reserve(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        slots_.emplace_back(new slot());
+        if(!line_buffered_)
+            slots_.back()->buf.reserve(buffer_size_);
+    }
+}
+//------------------------------------------------------------------------------
+writer::~writer()
+{
+    try {
+        flush();
+    } catch(...) {} // eat exception
+}
+//------------------------------------------------------------------------------
+void writer::commit(const size_t i)
+{
+    std::string &buf = slots_[i]->buf;
+    if(!line_buffered_ && buf.size() < buffer_size_)
+        return;
+    
+    std::lock_guard<std::mutex> lck(mtx_);
+    write(buf.data(), buf.size());
+    buf.clear();
+}
+//------------------------------------------------------------------------------
+void writer::flush()
+{
+    std::lock_guard<std::mutex> lck(mtx_);
+    
+    ::iovec iov[IOV_MAX];
+    size_t i = 0;
+    while(i < slots_.size())
+    {
+        int n = 0;
+        size_t total = 0;
+        for( ; i < slots_.size() && n < IOV_MAX; ++i)
+        {
+            std::string &buf = slots_[i]->buf;
+            if(buf.empty())
+                continue;
+            iov[n].iov_base = &buf[0];
+            iov[n].iov_len = buf.size();
+            total += buf.size();
+            ++n;
+        }
+        if(n == 0)
+            break;
+        
+        const ssize_t r = ::writev(fd_, iov, n);
+        if(r < 0 && errno != EINTR)
+            n_throw(output_error)
+            << fnd::ei_msg_c("Writing the output failed.");
+        
+        // Whatever writev() left over is written piecewise.
+        size_t done = r < 0 ? 0 : size_t(r);
+        if(done < total)
+        {
+            for(int k = 0; k < n; ++k)
+            {
+                const size_t len = iov[k].iov_len;
+                if(done >= len)
+                {
+                    done -= len;
+                    continue;
+                }
+                write(static_cast<const char *>(iov[k].iov_base) + done,
+                    len - done);
+                done = 0;
+            }
+        }
+    }
+    
+    for(auto &s : slots_)
+        s->buf.clear();
+}
+//------------------------------------------------------------------------------
+void writer::write(const char *s, size_t n)
+{
+    while(n > 0)
+    {
+        const ssize_t r = ::write(fd_, s, n);
+        if(r < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            n_throw(output_error)
+            << fnd::ei_msg_c("Writing the output failed.");
+        }
+        s += r;
+        n -= size_t(r);
+    }
+}
+
+} // recurse
@@ -0,0 +1,84 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#ifndef RECURSE_OUTPUT_H
+#define RECURSE_OUTPUT_H
+
+#include <nebula/foundation/exception.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace recurse {
+
+namespace fnd = nebula::foundation;
+
+//------------------------------------------------------------------------------
+struct output_error : public virtual fnd::runtime_error {};
+
+//------------------------------------------------------------------------------
+constexpr size_t default_buffer_size = size_t(256) * 1024;
+
+//------------------------------------------------------------------------------
+/** Collects output records in one reusable buffer per slot (traversal job)
+ * and writes them to a file descriptor in large chunks.
+ *
+ * A record is appended to buffer(slot) and completed by commit(slot). Only
+ * whole records are ever written, so concurrent slots do not interleave.
+ * In line buffered mode every record is written as soon as it is committed.
+ */
+class writer
+{
+public:
+    writer(int fd, size_t slots,
+        size_t buffer_size = default_buffer_size,
+        bool line_buffered = false);
+    ~writer();
+    
+    writer(const writer &) = delete;
+    writer &operator = (const writer &) = delete;
+    
+    std::string &buffer(const size_t slot) noexcept
+    {
+        return slots_[slot]->buf;
+    }
+    
+    void commit(size_t slot);
+    void flush();
+    
+private:
+    struct slot
+    {
+        std::string buf;
+    };
+    
+    void write(const char *s, size_t n);
+    
+    const int fd_;
+    const size_t buffer_size_;
+    const bool line_buffered_;
+    std::vector<std::unique_ptr<slot>> slots_;
+    std::mutex mtx_;
+};
+
+} // recurse
+
+#endif // RECURSE_OUTPUT_H
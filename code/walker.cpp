@@ -0,0 +1,439 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#include "walker.h"
+
+#include <nebula/foundation/scope_exit.h>
+
+#include <chrono>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace recurse {
+
+//------------------------------------------------------------------------------
+inline static fs::path to_path(const std::string &s)
+{
+    return fs::path(fnd::const_cstring(s.c_str()));
+}
+//------------------------------------------------------------------------------
+inline static fs::file_type to_file_type(const mode_t mode) noexcept
+{
+    switch(mode & S_IFMT)
+    {
+    case S_IFREG:
+        return fs::file_type::regular;
+    case S_IFDIR:
+        return fs::file_type::directory;
+    case S_IFLNK:
+        return fs::file_type::symlink;
+    case S_IFBLK:
+        return fs::file_type::block;
+    case S_IFIFO:
+        return fs::file_type::fifo;
+    case S_IFSOCK:
+        return fs::file_type::socket;
+    case S_IFCHR:
+        return fs::file_type::character_device;
+    default:
+        return fs::file_type::unknown;
+    }
+}
+//------------------------------------------------------------------------------
+inline static fs::file_type dirent_to_file_type(
+    const unsigned char type) noexcept
+{
+    switch(type)
+    {
+    case DT_REG:
+        return fs::file_type::regular;
+    case DT_DIR:
+        return fs::file_type::directory;
+    case DT_LNK:
+        return fs::file_type::symlink;
+    case DT_BLK:
+        return fs::file_type::block;
+    case DT_FIFO:
+        return fs::file_type::fifo;
+    case DT_SOCK:
+        return fs::file_type::socket;
+    case DT_CHR:
+        return fs::file_type::character_device;
+    default:
+        return fs::file_type::unknown;
+    }
+}
+
+#ifdef SYS_getdents64
+//------------------------------------------------------------------------------
+struct linux_dirent64
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+//------------------------------------------------------------------------------
+/** Reads the directory in chunks of dirent_buffer_size bytes, which saves
+ * most of the syscalls readdir() would issue with its small buffer.
+ */
+template <class F>
+inline static bool for_each_dirent(const int fd, char *buf, F &&f)
+{
+    for(;;)
+    {
+        const long n = ::syscall(SYS_getdents64, fd, buf, dirent_buffer_size);
+        if(n < 0)
+            return false;
+        if(n == 0)
+            return true;
+        
+        for(long off = 0; off < n; )
+        {
+            const linux_dirent64 *d
+                = reinterpret_cast<const linux_dirent64 *>(buf + off);
+            off += d->d_reclen;
+            if(!f(d->d_name, d->d_type))
+                return true;
+        }
+    }
+}
+#else
+//------------------------------------------------------------------------------
+template <class F>
+inline static bool for_each_dirent(const int fd, char *, F &&f)
+{
+    const int dup_fd = ::dup(fd);
+    if(dup_fd < 0)
+        return false;
+    DIR *dir = ::fdopendir(dup_fd);
+    if(!dir)
+    {
+        ::close(dup_fd);
+        return false;
+    }
+    n_scope_exit(&) {
+        ::closedir(dir);
+    };
+    
+    while(const ::dirent *e = ::readdir(dir))
+        if(!f(e->d_name, e->d_type))
+            break;
+    return true;
+}
+#endif
+
+//------------------------------------------------------------------------------
+walker::dir::~dir()
+{
+    release();
+}
+//------------------------------------------------------------------------------
+void walker::dir::release() noexcept
+{
+    if(fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+        --open_fds;
+    }
+}
+
+//------------------------------------------------------------------------------
+walker::walker(const size_t jobs, const size_t max_depth,
+    const size_t max_fds)
+: max_depth_(max_depth), max_fds_(max_fds)
+{
+    const size_t n = jobs == 0 ? 1 : jobs;
+    jobs_.reserve(n);
+    for(size_t i = 0; i < n; ++i)
+        jobs_.emplace_back(new job());
+}
+//------------------------------------------------------------------------------
+void walker::push(std::string root)
+{
+    roots_.push_back(fnd::move(root));
+}
+//------------------------------------------------------------------------------
+void walker::run(const visitor &f)
+{
+    // Roots are handed out from the back, so reverse them to keep the order
+    // of a single job stable.
+    std::vector<task> dirs;
+    for(auto i = roots_.rbegin(); i != roots_.rend(); ++i)
+    {
+        struct ::stat st;
+        if(::stat(i->c_str(), &st) != 0)
+            n_throw(walk_error)
+            << fnd::ei_msg_c("Accessing a path failed.")
+            << fs::ei_path(to_path(*i));
+        
+        if(S_ISDIR(st.st_mode))
+            dirs.push_back(std::make_shared<dir>(
+                nullptr, fnd::move(*i), 0, open_fds_));
+        else
+            f(entry(AT_FDCWD, i->c_str(), to_file_type(st.st_mode), 0,
+                0, jobs_[0]->path, 0));
+    }
+    roots_.clear();
+    
+    pending_ = dirs.size();
+    for(size_t i = 0; i < dirs.size(); ++i)
+        jobs_[i % jobs_.size()]->tasks.push_back(fnd::move(dirs[i]));
+    
+    std::vector<std::thread> threads;
+    n_scope_exit(&) {
+        for(std::thread &t : threads)
+            t.join();
+    };
+    
+    try {
+        for(size_t i = 1; i < jobs_.size(); ++i)
+            threads.emplace_back([this, i, &f] { work(i, f); });
+    } catch(...) {
+        fail(fnd::current_exception());
+    }
+    
+    work(0, f);
+    
+    for(std::thread &t : threads)
+        t.join();
+    threads.clear();
+    
+    for(auto &j : jobs_)
+        j->tasks.clear();
+    
+    if(error_)
+        std::rethrow_exception(error_);
+}
+//------------------------------------------------------------------------------
+void walker::work(const size_t self, const visitor &f)
+{
+    try {
+        jobs_[self]->buffer.reset(new char[dirent_buffer_size]);
+    } catch(...) {
+        fail(fnd::current_exception());
+        return;
+    }
+    
+    task t;
+    while(!stop_)
+    {
+        if(pop(self, t) || steal(self, t))
+        {
+            try {
+                scan(self, t, f);
+            } catch(...) {
+                fail(fnd::current_exception());
+            }
+            t.reset();
+            
+            if(--pending_ == 0)
+                idle_cv_.notify_all();
+            continue;
+        }
+        
+        if(pending_ == 0)
+            break;
+        
+        std::unique_lock<std::mutex> lck(idle_mtx_);
+        ++idle_;
+        idle_cv_.wait_for(lck, std::chrono::milliseconds(1));
+        --idle_;
+    }
+}
+//------------------------------------------------------------------------------
+void walker::scan(const size_t self, const task &t, const visitor &f)
+{
+    job &j = *jobs_[self];
+    
+    build_path(*t, j.path);
+    
+    int fd = -1;
+    if(t->parent)
+    {
+        dir &parent = *t->parent;
+        const bool held = parent.fd >= 0;
+        if(held)
+            fd = ::openat(parent.fd, t->name.c_str(),
+                O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        else
+            fd = ::open(j.path.c_str(),
+                O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        
+        if(held && --parent.unopened == 0)
+            parent.release();
+    }
+    else
+    {
+        fd = ::open(j.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    
+    if(fd < 0)
+        n_throw(walk_error)
+        << fnd::ei_msg_c("Opening a directory failed.")
+        << fs::ei_path(to_path(j.path));
+    bool keep = false;
+    n_scope_exit(&) {
+        if(!keep)
+            ::close(fd);
+    };
+    
+    if(j.path.empty() || j.path.back() != '/')
+        j.path.push_back('/');
+    const size_t prefix = j.path.size();
+    
+    const bool descend = t->level < max_depth_;
+    std::vector<task> subdirs;
+    
+    const bool ok = for_each_dirent(fd, j.buffer.get(),
+        [&] (const char *name, const unsigned char d_type) -> bool
+        {
+            if(stop_)
+                return false;
+            
+            if(name[0] == '.'
+                && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                return true;
+            
+            fs::file_type type = dirent_to_file_type(d_type);
+            if(type == fs::file_type::unknown)
+            {
+                struct ::stat st;
+                if(::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    j.path.resize(prefix);
+                    j.path += name;
+                    n_throw(walk_error)
+                    << fnd::ei_msg_c("Accessing a path failed.")
+                    << fs::ei_path(to_path(j.path));
+                }
+                type = to_file_type(st.st_mode);
+            }
+            
+            if(f(entry(fd, name, type, t->level, self, j.path, prefix))
+                && type == fs::file_type::directory && descend)
+                subdirs.push_back(std::make_shared<dir>(
+                    t, name, t->level + 1, open_fds_));
+            return true;
+        });
+    if(!ok)
+    {
+        j.path.resize(prefix);
+        n_throw(walk_error)
+        << fnd::ei_msg_c("Reading a directory failed.")
+        << fs::ei_path(to_path(j.path));
+    }
+    
+    if(subdirs.empty())
+        return;
+    
+    // Keep the descriptor for openat() of the subdirectories.
+    if(open_fds_.fetch_add(1) < max_fds_)
+    {
+        keep = true;
+        t->fd = fd;
+        t->unopened = subdirs.size();
+    }
+    else
+    {
+        --open_fds_;
+    }
+    
+    schedule(self, subdirs);
+}
+//------------------------------------------------------------------------------
+bool walker::pop(const size_t self, task &t)
+{
+    job &j = *jobs_[self];
+    std::lock_guard<std::mutex> lck(j.mtx);
+    if(j.tasks.empty())
+        return false;
+    t = fnd::move(j.tasks.back());
+    j.tasks.pop_back();
+    return true;
+}
+//------------------------------------------------------------------------------
+bool walker::steal(const size_t self, task &t)
+{
+    const size_t n = jobs_.size();
+    for(size_t i = 1; i < n; ++i)
+    {
+        job &j = *jobs_[(self + i) % n];
+        std::lock_guard<std::mutex> lck(j.mtx);
+        if(j.tasks.empty())
+            continue;
+        t = fnd::move(j.tasks.front());
+        j.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+//------------------------------------------------------------------------------
+void walker::schedule(const size_t self, std::vector<task> &tasks)
+{
+    if(tasks.empty())
+        return;
+    
+    pending_ += tasks.size();
+    {
+        job &j = *jobs_[self];
+        std::lock_guard<std::mutex> lck(j.mtx);
+        // Pushed in reverse so that pop() yields directory order.
+        for(auto i = tasks.rbegin(); i != tasks.rend(); ++i)
+            j.tasks.push_back(fnd::move(*i));
+    }
+    
+    if(idle_ > 0)
+        idle_cv_.notify_all();
+}
+//------------------------------------------------------------------------------
+void walker::build_path(const dir &d, std::string &s)
+{
+    if(!d.parent)
+    {
+        s = d.name;
+        return;
+    }
+    
+    build_path(*d.parent, s);
+    if(s.empty() || s.back() != '/')
+        s.push_back('/');
+    s += d.name;
+}
+//------------------------------------------------------------------------------
+void walker::fail(std::exception_ptr x)
+{
+    {
+        std::lock_guard<std::mutex> lck(error_mtx_);
+        if(!error_)
+            error_ = x;
+    }
+    stop_ = true;
+    idle_cv_.notify_all();
+}
+
+} // recurse
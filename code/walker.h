@@ -0,0 +1,181 @@
+/*--!>
+This file is part of Recurse, a simple recursive file scanner written in C++.
+
+Copyright 2015-2016 outshined (outshined@riseup.net)
+    (PGP: 0x8A80C12396A4836F82A93FA79CA3D0F7E8FBCED6)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+--------------------------------------------------------------------------<!--*/
+#ifndef RECURSE_WALKER_H
+#define RECURSE_WALKER_H
+
+#include <nebula/foundation/exception.h>
+#include <nebula/foundation/filesystem.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace recurse {
+
+namespace fnd = nebula::foundation;
+namespace fs = fnd::filesystem;
+
+//------------------------------------------------------------------------------
+struct walk_error : public virtual fnd::runtime_error {};
+
+//------------------------------------------------------------------------------
+/** A directory entry as seen by a visitor.
+ *
+ * The type is taken from the directory entry itself. Only filesystems
+ * which do not report it cost an additional fstatat(). Further lookups
+ * should be done relative to dir_fd using the bare name. The full path is
+ * only assembled when path() is called. The job is the index of the
+ * traversal job, in [0, walker::jobs()).
+ */
+struct entry
+{
+    entry(int dir_fd_, const char *name_, fs::file_type type_, size_t level_,
+        size_t job_, std::string &buf, size_t prefix) noexcept
+    : dir_fd(dir_fd_), name(name_), type(type_), level(level_), job(job_),
+        buf_(buf), prefix_(prefix)
+    {}
+    
+    const std::string &path() const
+    {
+        if(!built_)
+        {
+            buf_.resize(prefix_);
+            buf_ += name;
+            built_ = true;
+        }
+        return buf_;
+    }
+    
+    const int dir_fd;
+    const char *const name;
+    const fs::file_type type;
+    const size_t level;
+    const size_t job;
+    
+private:
+    std::string &buf_;
+    const size_t prefix_;
+    mutable bool built_ = false;
+};
+
+//------------------------------------------------------------------------------
+/** Invoked for every entry below a root. The return value decides whether a
+ * directory entry is descended into. Visitors must be thread-safe when the
+ * walker runs with more than one job.
+ */
+using visitor = std::function<bool (const entry &)>;
+
+//------------------------------------------------------------------------------
+constexpr size_t dirent_buffer_size = size_t(128) * 1024;
+constexpr size_t default_max_fds = 256;
+
+//------------------------------------------------------------------------------
+/** Work-stealing directory traversal.
+ *
+ * Every job owns a deque of pending directories. A job pops from the back of
+ * its own deque (depth first) and, once it runs dry, steals from the front of
+ * the others, where the largest subtrees tend to sit.
+ *
+ * Directories are opened with openat() relative to their parent, which is
+ * kept open until all of its subdirectories have been opened. At most
+ * max_fds descriptors are held that way; beyond that a directory is opened
+ * by its full path instead.
+ */
+class walker
+{
+public:
+    walker(size_t jobs, size_t max_depth,
+        size_t max_fds = default_max_fds);
+    
+    walker(const walker &) = delete;
+    walker &operator = (const walker &) = delete;
+    
+    size_t jobs() const noexcept
+    {
+        return jobs_.size();
+    }
+    
+    void push(std::string root);
+    void run(const visitor &f);
+    
+private:
+    struct dir
+    {
+        dir(std::shared_ptr<dir> parent_, std::string name_, size_t level_,
+            std::atomic<size_t> &open_fds_)
+        : parent(fnd::move(parent_)), name(fnd::move(name_)), level(level_),
+            open_fds(open_fds_)
+        {}
+        ~dir();
+        
+        void release() noexcept;
+        
+        const std::shared_ptr<dir> parent;
+        const std::string name;
+        const size_t level;
+        int fd = -1;
+        std::atomic<size_t> unopened{0};
+        std::atomic<size_t> &open_fds;
+    };
+    
+    using task = std::shared_ptr<dir>;
+    
+    struct job
+    {
+        std::mutex mtx;
+        std::deque<task> tasks;
+        std::unique_ptr<char[]> buffer;
+        std::string path;
+    };
+    
+    void work(size_t self, const visitor &f);
+    void scan(size_t self, const task &t, const visitor &f);
+    bool pop(size_t self, task &t);
+    bool steal(size_t self, task &t);
+    void schedule(size_t self, std::vector<task> &tasks);
+    void fail(std::exception_ptr x);
+    
+    static void build_path(const dir &d, std::string &s);
+    
+    const size_t max_depth_;
+    const size_t max_fds_;
+    std::vector<std::unique_ptr<job>> jobs_;
+    std::vector<std::string> roots_;
+    
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> open_fds_{0};
+    std::atomic<bool> stop_{false};
+    
+    std::mutex idle_mtx_;
+    std::condition_variable idle_cv_;
+    std::atomic<size_t> idle_{0};
+    
+    std::mutex error_mtx_;
+    std::exception_ptr error_;
+};
+
+} // recurse
+
+#endif // RECURSE_WALKER_H